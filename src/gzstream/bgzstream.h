@@ -0,0 +1,247 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following disclaimer
+//     in the documentation and/or other materials provided with the
+//     distribution.
+//   * Neither the name of Google Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// -----------------------------------------------------------------------------
+//
+// Block-compressed gzip streams, in the style of BGZF: output is a series
+// of independent gzip members, each holding at most 64KB of compressed data
+// and recording its own compressed size in a gzip "extra" subfield, so that
+// any gzip reader can decompress it, while these classes can compress and
+// decompress consecutive blocks in parallel.
+
+#ifndef BGZSTREAM_H
+#define BGZSTREAM_H 1
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#ifdef GZSTREAM_NAMESPACE
+namespace GZSTREAM_NAMESPACE {
+#endif
+
+// ----------------------------------------------------------------------------
+// Internal classes to implement bgzstream. See below for user classes.
+// ----------------------------------------------------------------------------
+
+// A streambuf that reads and writes block-compressed gzip files using a
+// pool of worker threads.  When reading, the consumer thread reads
+// compressed blocks into a ring of slots, workers inflate them in parallel
+// and the consumer reads each block's uncompressed bytes in order.  When
+// writing, each full block is handed to the workers to deflate and written
+// out in order once compressed.  Input files that are not block-compressed
+// (ordinary gzip files or uncompressed files) are read sequentially via
+// zlib's gz* interface, exactly as gzstreambuf would read them.
+class bgzstreambuf : public std::streambuf {
+ public:
+  // The maximum number of bytes in a compressed block, including its header
+  // and footer.
+  static const int kMaxBlockSize = 65536;
+  // The maximum number of uncompressed bytes in a block, chosen so that
+  // even incompressible data fits in a block.
+  static const int kMaxUncompressedBlockSize = 0xff00;
+
+  // Constructs a new instance that will use the specified number of worker
+  // threads, or one per hardware thread if num_threads is not positive.
+  bgzstreambuf(int num_threads = 0);
+  ~bgzstreambuf() { close(); }
+
+  // Returns whether the specified file begins with a block-compressed gzip
+  // header.
+  static bool is_bgzf(const char* name);
+
+  int is_open() { return opened; }
+  bgzstreambuf* open(const char* name, int open_mode);
+  // Opens this buffer on an already-open file descriptor, such as that of
+  // standard input or output, which may be a pipe.  Input is read
+  // sequentially, and may be gzip-compressed (block-compressed or not) or
+  // not compressed at all, as detected from its first bytes; output is
+  // block-compressed in parallel.  The descriptor itself is not closed.
+  bgzstreambuf* attach(int fd, int open_mode);
+  bgzstreambuf* close();
+
+  virtual int overflow(int c = EOF);
+  virtual int underflow();
+  virtual int sync();
+
+  // Returns the position at which the next byte will be written.  Because
+  // the sizes of blocks still being compressed are not yet known, this is
+  // a provisional position, which must be passed to resolve() once the
+  // stream has been flushed.  Returns -1 if not open for writing.
+  long long tell();
+  // Converts a provisional position returned by tell() into a virtual
+  // offset: the offset of a block in the compressed file, shifted left by
+  // 16 bits, plus an offset within that block's uncompressed bytes.  The
+  // block containing the position must already have been written out.
+  // Returns -1 if it has not.
+  long long resolve(long long position) const;
+  // Positions a block-compressed input stream at the specified virtual
+  // offset.  Returns whether the seek succeeded, which it cannot for files
+  // that are not block-compressed.
+  bool seek(long long virtual_offset);
+
+ private:
+  enum BlockState { EMPTY, PENDING, WORKING, DONE };
+
+  struct Block {
+    Block() : state(EMPTY), ok(true), size(0), offset(0) { }
+    std::string compressed;
+    std::string uncompressed;
+    BlockState state;
+    bool ok;
+    // The number of valid bytes in uncompressed.
+    int size;
+    // The offset of this block in the compressed file (reading only).
+    long long offset;
+  };
+
+  bgzstreambuf(const bgzstreambuf&);
+  bgzstreambuf& operator=(const bgzstreambuf&);
+
+  // Prepares to open in the specified mode, returning false if this buffer
+  // is already open or the mode is unsupported.
+  bool reset(int open_mode);
+  bgzstreambuf* open_sequential();
+  bgzstreambuf* open_blocks();
+
+  void start_workers();
+  void stop_workers();
+  void work();
+  bool deflate_block(z_stream* strm, Block* block);
+  bool inflate_block(z_stream* strm, Block* block);
+
+  // Reading.
+  bool read_compressed_block(Block* block);
+  void fill_ring();
+  void release_head();
+  int underflow_sequential();
+
+  // Writing.
+  void put_area_to(Block* block);
+  bool flush_block();
+  bool write_done_blocks(bool wait_for_all);
+
+  int num_threads;
+  char opened;
+  int mode;
+  bool error;
+
+  // Sequential fallback when reading files that are not block-compressed.
+  bool sequential;
+  gzFile gzfile;
+  std::vector<char> seq_buffer;
+
+  // Block-compressed reading and writing.
+  FILE* file;
+  bool eof;
+  std::vector<Block> ring;
+  // The slot of the oldest block in flight, and the number of blocks
+  // in flight, starting at head.
+  int head;
+  int in_flight;
+  // Whether the consumer is currently reading from the block at head.
+  bool head_in_use;
+  // The number of blocks to read ahead, which is reset to one after a seek
+  // and doubles with each block consumed, up to the size of the ring.
+  int readahead;
+  // The number of uncompressed bytes to skip in the next block read, after
+  // a seek.
+  int skip;
+  // The number of blocks handed to the workers so far, and the offset in
+  // the compressed file of each block written so far (writing only).
+  long long num_blocks;
+  std::vector<long long> block_offsets;
+  long long bytes_written;
+  // Slots whose blocks await a worker, in order.
+  std::deque<int> pending;
+  bool stopping;
+  std::mutex mutex;
+  std::condition_variable work_cv;
+  std::condition_variable done_cv;
+  std::vector<std::thread> workers;
+};
+
+class bgzstreambase : virtual public std::ios {
+ protected:
+  bgzstreambuf buf;
+ public:
+  bgzstreambase() { init(&buf); }
+  bgzstreambase(const char* name, int open_mode);
+  ~bgzstreambase();
+  void open(const char* name, int open_mode);
+  void attach(int fd, int open_mode);
+  void close();
+  bgzstreambuf* rdbuf() { return &buf; }
+};
+
+// ----------------------------------------------------------------------------
+// User classes. Use ibgzstream and obgzstream analogously to igzstream and
+// ogzstream respectively. Files written by obgzstream can be read by any
+// gzip reader, and ibgzstream reads any file that igzstream can read,
+// decompressing in parallel only those files written by obgzstream.
+// ----------------------------------------------------------------------------
+
+class ibgzstream : public bgzstreambase, public std::istream {
+ public:
+  ibgzstream() : std::istream(&buf) {}
+  ibgzstream(const char* name, int open_mode = std::ios::in)
+      : bgzstreambase(name, open_mode), std::istream(&buf) {}
+  bgzstreambuf* rdbuf() { return bgzstreambase::rdbuf(); }
+  void open(const char* name, int open_mode = std::ios::in) {
+    bgzstreambase::open(name, open_mode);
+  }
+  void attach(int fd, int open_mode = std::ios::in) {
+    bgzstreambase::attach(fd, open_mode);
+  }
+};
+
+class obgzstream : public bgzstreambase, public std::ostream {
+ public:
+  obgzstream() : std::ostream(&buf) {}
+  obgzstream(const char* name, int mode = std::ios::out)
+      : bgzstreambase(name, mode), std::ostream(&buf) {}
+  bgzstreambuf* rdbuf() { return bgzstreambase::rdbuf(); }
+  void open(const char* name, int open_mode = std::ios::out) {
+    bgzstreambase::open(name, open_mode);
+  }
+  void attach(int fd, int open_mode = std::ios::out) {
+    bgzstreambase::attach(fd, open_mode);
+  }
+};
+
+#ifdef GZSTREAM_NAMESPACE
+}  // namespace GZSTREAM_NAMESPACE
+#endif
+
+#endif  // BGZSTREAM_H
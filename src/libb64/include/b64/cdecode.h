@@ -50,6 +50,9 @@ int base64_decode_value(char value_in);
 
 int base64_decode_block(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in);
 
+/* Identical to base64_decode_block, but never uses vector instructions. */
+int base64_decode_block_scalar(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in);
+
 
 
 #endif /* BASE64_CDECODE_H */
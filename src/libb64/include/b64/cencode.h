@@ -52,6 +52,9 @@ char base64_encode_value(char value_in);
 
 int base64_encode_block(const char* plaintext_in, int length_in, char* code_out, base64_encodestate* state_in);
 
+/* Identical to base64_encode_block, but never uses vector instructions. */
+int base64_encode_block_scalar(const char* plaintext_in, int length_in, char* code_out, base64_encodestate* state_in);
+
 
 
 int base64_encode_blockend(char* code_out, base64_encodestate* state_in);
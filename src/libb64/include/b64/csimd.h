@@ -0,0 +1,44 @@
+/*
+csimd.h - c header for vectorized bulk base64 encoding and decoding
+This extends the libb64 project, which has been placed in the public domain.
+For details, see http://sourceforge.net/projects/libb64
+*/
+
+#ifndef BASE64_CSIMD_H
+#define BASE64_CSIMD_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum
+{
+	base64_scalar, base64_ssse3, base64_avx2
+} base64_simd_level;
+
+/* Returns whether this processor supports the specified level. */
+int base64_simd_supported(base64_simd_level level_in);
+/* Returns the level used by base64_encode_block and base64_decode_block,
+   which is the best level this processor supports unless overridden. */
+base64_simd_level base64_get_simd_level(void);
+/* Overrides the level used, falling back to the best supported level
+   below the specified one (mostly for testing and benchmarking). */
+void base64_set_simd_level(base64_simd_level level_in);
+
+/* Encodes as many whole 3-byte groups from the beginning of plaintext_in
+   as can be done with vector instructions, setting *consumed_out to the
+   number of bytes encoded, and returns the number of characters written. */
+int base64_encode_bulk(const char* plaintext_in, int length_in, char* code_out, int* consumed_out);
+/* Decodes as many whole 4-character groups from the beginning of code_in
+   as can be done with vector instructions, stopping at the first vector
+   containing a character outside the base64 alphabet, setting
+   *consumed_out to the number of characters decoded, and returns the
+   number of bytes written. */
+int base64_decode_bulk(const char* code_in, int length_in, char* plaintext_out, int* consumed_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BASE64_CSIMD_H */
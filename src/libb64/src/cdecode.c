@@ -6,6 +6,7 @@ For details, see http://sourceforge.net/projects/libb64
 */
 
 #include <b64/cdecode.h>
+#include <b64/csimd.h>
 
 int base64_decode_value(char value_in)
 {
@@ -22,7 +23,7 @@ void base64_init_decodestate(base64_decodestate* state_in)
 	state_in->plainchar = 0;
 }
 
-int base64_decode_block(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in)
+int base64_decode_block_scalar(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in)
 {
 	const char* codechar = code_in;
 	char* plainchar = plaintext_out;
@@ -86,3 +87,33 @@ int base64_decode_block(const char* code_in, const int length_in, char* plaintex
 	return plainchar - plaintext_out;
 }
 
+
+int base64_decode_block(const char* code_in, const int length_in, char* plaintext_out, base64_decodestate* state_in)
+{
+	const char* codechar = code_in;
+	const char* const codeend = code_in + length_in;
+	char* plainchar = plaintext_out;
+	int consumed;
+	
+	if (length_in <= 0 || base64_get_simd_level() == base64_scalar)
+	{
+		return base64_decode_block_scalar(code_in, length_in, plaintext_out, state_in);
+	}
+	while (codechar < codeend)
+	{
+		/* Decode whole groups with vector instructions when we can. */
+		if (state_in->step == step_a)
+		{
+			plainchar += base64_decode_bulk(codechar, codeend - codechar, plainchar, &consumed);
+			codechar += consumed;
+			if (codechar == codeend) break;
+		}
+		/* Otherwise, decode a character at a time until we are back at
+		   the start of a group, such as after padding or a newline. */
+		do
+		{
+			plainchar += base64_decode_block_scalar(codechar++, 1, plainchar, state_in);
+		} while (codechar < codeend && state_in->step != step_a);
+	}
+	return plainchar - plaintext_out;
+}
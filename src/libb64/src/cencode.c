@@ -6,6 +6,7 @@ For details, see http://sourceforge.net/projects/libb64
 */
 
 #include <b64/cencode.h>
+#include <b64/csimd.h>
 
 const int CHARS_PER_LINE = 72;
 
@@ -23,7 +24,7 @@ char base64_encode_value(char value_in)
 	return encoding[(int)value_in];
 }
 
-int base64_encode_block(const char* plaintext_in, int length_in, char* code_out, base64_encodestate* state_in)
+int base64_encode_block_scalar(const char* plaintext_in, int length_in, char* code_out, base64_encodestate* state_in)
 {
 	const char* plainchar = plaintext_in;
 	const char* const plaintextend = plaintext_in + length_in;
@@ -86,6 +87,21 @@ int base64_encode_block(const char* plaintext_in, int length_in, char* code_out,
 	return codechar - code_out;
 }
 
+int base64_encode_block(const char* plaintext_in, int length_in, char* code_out, base64_encodestate* state_in)
+{
+	int consumed = 0;
+	int codelength = 0;
+	
+	/* Encode whole groups with vector instructions when we can, leaving
+	   any remainder to the state machine. */
+	if (state_in->step == step_A)
+	{
+		codelength = base64_encode_bulk(plaintext_in, length_in, code_out, &consumed);
+		state_in->stepcount = (state_in->stepcount + codelength/4) % (CHARS_PER_LINE/4);
+	}
+	return codelength + base64_encode_block_scalar(plaintext_in + consumed, length_in - consumed, code_out + codelength, state_in);
+}
+
 int base64_encode_blockend(char* code_out, base64_encodestate* state_in)
 {
 	char* codechar = code_out;
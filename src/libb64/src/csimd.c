@@ -0,0 +1,277 @@
+/*
+csimd.c - c source for vectorized bulk base64 encoding and decoding
+
+This extends the libb64 project, which has been placed in the public domain.
+For details, see http://sourceforge.net/projects/libb64
+
+The SSSE3 and AVX2 code follows the approach described by Wojciech Mula
+and Daniel Lemire in "Faster Base64 Encoding and Decoding Using AVX2
+Instructions" (ACM Transactions on the Web, 2018): bytes are reshuffled
+and shifted into 6-bit indices with multiplies, which are mapped to and
+from the base64 alphabet with byte shuffles over small lookup tables.
+*/
+
+#include <string.h>
+#include <b64/csimd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+static int simd_level = -1;
+
+int base64_simd_supported(base64_simd_level level_in)
+{
+	switch (level_in)
+	{
+	case base64_scalar:
+		return 1;
+#ifdef BASE64_X86
+	case base64_ssse3:
+		return __builtin_cpu_supports("ssse3");
+	case base64_avx2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+base64_simd_level base64_get_simd_level(void)
+{
+	if (simd_level < 0)
+	{
+		base64_set_simd_level(base64_avx2);
+	}
+	return (base64_simd_level)simd_level;
+}
+
+void base64_set_simd_level(base64_simd_level level_in)
+{
+	while (level_in > base64_scalar && !base64_simd_supported(level_in))
+	{
+		level_in = (base64_simd_level)(level_in - 1);
+	}
+	simd_level = level_in;
+}
+
+#ifdef BASE64_X86
+
+/* Moves each group of three bytes into four 16-bit halves of a 32-bit
+   lane, then shifts each 6-bit index into the low bits of its own byte. */
+__attribute__((target("ssse3")))
+static __m128i encode_reshuffle_ssse3(__m128i in)
+{
+	const __m128i shuffled = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m128i t0 = _mm_and_si128(shuffled, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(shuffled, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+/* Maps 6-bit indices to characters by adding an offset that depends
+   only on which range of the alphabet each index falls in. */
+__attribute__((target("ssse3")))
+static __m128i encode_lookup_ssse3(__m128i indices)
+{
+	const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	__m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+
+__attribute__((target("ssse3")))
+static int encode_bulk_ssse3(const char* plaintext_in, int length_in, char* code_out, int* consumed_out)
+{
+	int consumed = 0;
+	int codelength = 0;
+	/* Each iteration reads 16 bytes but encodes only the first 12. */
+	while (length_in - consumed >= 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)(plaintext_in + consumed));
+		__m128i out = encode_lookup_ssse3(encode_reshuffle_ssse3(in));
+		_mm_storeu_si128((__m128i*)(code_out + codelength), out);
+		consumed += 12;
+		codelength += 16;
+	}
+	*consumed_out = consumed;
+	return codelength;
+}
+
+__attribute__((target("avx2")))
+static int encode_bulk_avx2(const char* plaintext_in, int length_in, char* code_out, int* consumed_out)
+{
+	const __m256i reshuffle = _mm256_broadcastsi128_si256(_mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m256i shift_lut = _mm256_broadcastsi128_si256(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0));
+	int consumed = 0;
+	int codelength = 0;
+	/* Each iteration encodes 24 bytes, 12 in each 128-bit lane, reading
+	   up to 28. */
+	while (length_in - consumed >= 28)
+	{
+		const char* in_ptr = plaintext_in + consumed;
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)in_ptr)), _mm_loadu_si128((const __m128i*)(in_ptr + 12)), 1);
+		__m256i shuffled = _mm256_shuffle_epi8(in, reshuffle);
+		__m256i t0 = _mm256_and_si256(shuffled, _mm256_set1_epi32(0x0fc0fc00));
+		__m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		__m256i t2 = _mm256_and_si256(shuffled, _mm256_set1_epi32(0x003f03f0));
+		__m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		__m256i indices = _mm256_or_si256(t1, t3);
+		__m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		__m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+		result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices);
+		_mm256_storeu_si256((__m256i*)(code_out + codelength), result);
+		consumed += 24;
+		codelength += 32;
+	}
+	*consumed_out = consumed;
+	return codelength;
+}
+
+/* Maps characters to their 6-bit values, returning 0 if any character
+   in the vector is not in the base64 alphabet. */
+__attribute__((target("ssse3")))
+static int decode_lookup_ssse3(__m128i in, __m128i* values_out)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+	const __m128i lo_nibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+	const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+	const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+	const __m128i invalid = _mm_and_si128(lo, hi);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xffff)
+	{
+		return 0;
+	}
+	const __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+	const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+	*values_out = _mm_add_epi8(in, roll);
+	return 1;
+}
+
+/* Packs four 6-bit values per 32-bit lane into three bytes, leaving the
+   twelve decoded bytes at the start of the vector. */
+__attribute__((target("ssse3")))
+static __m128i decode_pack_ssse3(__m128i values)
+{
+	const __m128i merge_ab_and_bc = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+	const __m128i merged = _mm_madd_epi16(merge_ab_and_bc, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static int decode_bulk_ssse3(const char* code_in, int length_in, char* plaintext_out, int* consumed_out)
+{
+	int consumed = 0;
+	int plainlength = 0;
+	char block[16];
+	while (length_in - consumed >= 16)
+	{
+		__m128i values;
+		__m128i in = _mm_loadu_si128((const __m128i*)(code_in + consumed));
+		if (!decode_lookup_ssse3(in, &values))
+		{
+			break;
+		}
+		/* Never write past the bytes actually decoded. */
+		_mm_storeu_si128((__m128i*)block, decode_pack_ssse3(values));
+		memcpy(plaintext_out + plainlength, block, 12);
+		consumed += 16;
+		plainlength += 12;
+	}
+	*consumed_out = consumed;
+	return plainlength;
+}
+
+__attribute__((target("avx2")))
+static int decode_bulk_avx2(const char* code_in, int length_in, char* plaintext_out, int* consumed_out)
+{
+	const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+	const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+	const __m256i lut_roll = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+	const __m256i pack_shuffle = _mm256_broadcastsi128_si256(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	int consumed = 0;
+	int plainlength = 0;
+	char block[32];
+	while (length_in - consumed >= 32)
+	{
+		__m256i in = _mm256_loadu_si256((const __m256i*)(code_in + consumed));
+		__m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0f));
+		__m256i lo_nibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+		__m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		__m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		if (!_mm256_testz_si256(lo, hi))
+		{
+			break;
+		}
+		__m256i eq_2f = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(0x2f));
+		__m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+		__m256i values = _mm256_add_epi8(in, roll);
+		__m256i merge_ab_and_bc = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		__m256i merged = _mm256_madd_epi16(merge_ab_and_bc, _mm256_set1_epi32(0x00011000));
+		__m256i packed = _mm256_shuffle_epi8(merged, pack_shuffle);
+		/* Bring the 12 bytes decoded in each lane together. */
+		packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_storeu_si256((__m256i*)block, packed);
+		memcpy(plaintext_out + plainlength, block, 24);
+		consumed += 32;
+		plainlength += 24;
+	}
+	*consumed_out = consumed;
+	return plainlength;
+}
+
+#endif /* BASE64_X86 */
+
+int base64_encode_bulk(const char* plaintext_in, int length_in, char* code_out, int* consumed_out)
+{
+	int codelength = 0;
+	*consumed_out = 0;
+#ifdef BASE64_X86
+	int consumed = 0;
+	switch (base64_get_simd_level())
+	{
+	case base64_avx2:
+		codelength = encode_bulk_avx2(plaintext_in, length_in, code_out, &consumed);
+		*consumed_out = consumed;
+		/* fall through */
+	case base64_ssse3:
+		codelength += encode_bulk_ssse3(plaintext_in + *consumed_out, length_in - *consumed_out, code_out + codelength, &consumed);
+		*consumed_out += consumed;
+		break;
+	case base64_scalar:
+		break;
+	}
+#endif
+	return codelength;
+}
+
+int base64_decode_bulk(const char* code_in, int length_in, char* plaintext_out, int* consumed_out)
+{
+	int plainlength = 0;
+	*consumed_out = 0;
+#ifdef BASE64_X86
+	int consumed = 0;
+	switch (base64_get_simd_level())
+	{
+	case base64_avx2:
+		plainlength = decode_bulk_avx2(code_in, length_in, plaintext_out, &consumed);
+		*consumed_out = consumed;
+		/* fall through */
+	case base64_ssse3:
+		plainlength += decode_bulk_ssse3(code_in + *consumed_out, length_in - *consumed_out, plaintext_out + plainlength, &consumed);
+		*consumed_out += consumed;
+		break;
+	case base64_scalar:
+		break;
+	}
+#endif
+	return plainlength;
+}
@@ -31,12 +31,16 @@
 // Convert Philipp's MT n-best list format to a DataSet protocol buffer.
 // Author: kbhall@google.com (Keith Hall)
 
+#include <cctype>
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unistd.h>
+#include <google/protobuf/io/coded_stream.h>
 #include "dataio.h"
-#include "../gzstream/gzstream.h"
+#include "../gzstream/bgzstream.h"
 #include "../utils/kdebug.h"
 INITDEBUG(0);
 
@@ -44,8 +48,14 @@ using namespace std;
 
 const int kBufferSize = 1 >> 20;
 
+// The maximum number of bytes in a varint-encoded 32-bit size.
+const int kMaxVarint32Bytes = 5;
+
+const char ConfusionProtoIO::kVarintMagic[] = "RFRVAR01";
+const int ConfusionProtoIO::kVarintMagicLength = 8;
+
 ConfusionProtoIO::ConfusionProtoIO()
-    : base64_(true), is_compressed_(false),
+    : base64_(true), is_compressed_(false), framing_(VARINT_FRAMING),
       inputs_(NULL), outputs_(NULL),
       iobuffer_(NULL), b64buffer_(NULL), bufsize_(0),
       encode_obj_(kBufferSize), decode_obj_(kBufferSize) {
@@ -55,50 +65,103 @@ ConfusionProtoIO::ConfusionProtoIO(const string& file_name,
                                    Mode iomode,
                                    bool compressed,
                                    bool base64)
-    : base64_(base64), is_compressed_(compressed),
+    : base64_(base64), is_compressed_(compressed), framing_(VARINT_FRAMING),
       inputs_(NULL), outputs_(NULL),
       iobuffer_(NULL), b64buffer_(NULL), bufsize_(0),
       encode_obj_(kBufferSize), decode_obj_(kBufferSize) {
   // Open the raw file:
   switch (iomode) {
    case READSTD:
-     if (compressed) {
-       cerr << "Compression on stdin not supported";
+     {
+       // Whether standard input is compressed is detected from its first
+       // bytes, so compressed and uncompressed streams may both be piped in.
+       ibgzstream* std_inputs = new ibgzstream();
+       std_inputs->attach(STDIN_FILENO);
+       inputs_ = std_inputs;
      }
-     inputs_ = &cin;
      break;
    case READ:
      if (compressed) {
-       inputs_ = new igzstream(file_name.c_str());
+       inputs_ = new ibgzstream(file_name.c_str());
      } else {
        inputs_ = new ifstream(file_name.c_str());
      }
     break;
    case WRITESTD:
      if (compressed) {
-       cerr << "Compression on stdout not supported";
+       // Anything already written to cout must precede our compressed data.
+       cout.flush();
+       obgzstream* std_outputs = new obgzstream();
+       std_outputs->attach(STDOUT_FILENO);
+       outputs_ = std_outputs;
+     } else {
+       outputs_ = &cout;
      }
-     outputs_ = &cout;
      break;
    case WRITE:
      if (compressed) {
-       outputs_ = new ogzstream(file_name.c_str());
+       outputs_ = new obgzstream(file_name.c_str());
      } else {
        outputs_ = new ofstream(file_name.c_str());
      }
      break;
   };
+  if (!base64_) {
+    if (inputs_ != NULL) {
+      DetectFraming();
+    } else if (outputs_ != NULL) {
+      outputs_->write(kVarintMagic, kVarintMagicLength);
+    }
+  }
+}
+
+void ConfusionProtoIO::DetectFraming() {
+  // Sizes in legacy files were written as decimal text, so a file
+  // starting with anything else must start with the magic header.
+  int c = inputs_->peek();
+  if (c == EOF || isdigit(c) || isspace(c)) {
+    framing_ = LEGACY_FRAMING;
+    CDEBUG(5, "Reading legacy raw framing");
+    return;
+  }
+  char magic[kVarintMagicLength];
+  inputs_->read(magic, kVarintMagicLength);
+  if (inputs_->gcount() != kVarintMagicLength ||
+      string(magic, kVarintMagicLength) !=
+      string(kVarintMagic, kVarintMagicLength)) {
+    cerr << "Unrecognized raw file header" << endl;
+    inputs_->setstate(ios::failbit);
+  }
+  framing_ = VARINT_FRAMING;
 }
 
 ConfusionProtoIO::~ConfusionProtoIO() {
   Close();
 }
 
-void ConfusionProtoIO::Close(void) {
+bool ConfusionProtoIO::Close(void) {
   if (inputs_ != &cin) {
     delete inputs_;
   }
   inputs_ = NULL;
+  bool ok = true;
+  if (outputs_ != NULL) {
+    // Close the file explicitly, so that errors flushing buffered or
+    // compressed data are reflected in the stream's state.
+    obgzstream* compressed_outputs = dynamic_cast<obgzstream*>(outputs_);
+    ofstream* file_outputs = dynamic_cast<ofstream*>(outputs_);
+    if (compressed_outputs != NULL) {
+      compressed_outputs->close();
+    } else if (file_outputs != NULL) {
+      file_outputs->close();
+    } else {
+      outputs_->flush();
+    }
+    ok = !outputs_->fail();
+    if (!ok) {
+      cerr << "Unable to write to output stream" << endl;
+    }
+  }
   if (outputs_ != &cout) {
     delete outputs_;
   }
@@ -110,6 +173,39 @@ void ConfusionProtoIO::Close(void) {
     b64buffer_ = NULL;
     bufsize_ = 0;
   }
+  return ok;
+}
+
+long long ConfusionProtoIO::Tell() {
+  if (outputs_ == NULL || outputs_ == &cout) {
+    return -1;
+  }
+  obgzstream* compressed_outputs = dynamic_cast<obgzstream*>(outputs_);
+  if (compressed_outputs != NULL) {
+    return compressed_outputs->rdbuf()->tell();
+  }
+  return outputs_->tellp();
+}
+
+long long ConfusionProtoIO::ResolvePosition(long long position) {
+  obgzstream* compressed_outputs = dynamic_cast<obgzstream*>(outputs_);
+  if (compressed_outputs != NULL && position >= 0) {
+    return compressed_outputs->rdbuf()->resolve(position);
+  }
+  return position;
+}
+
+bool ConfusionProtoIO::Seek(long long position) {
+  if (inputs_ == NULL || inputs_ == &cin || position < 0) {
+    return false;
+  }
+  inputs_->clear();
+  ibgzstream* compressed_inputs = dynamic_cast<ibgzstream*>(inputs_);
+  if (compressed_inputs != NULL) {
+    return compressed_inputs->rdbuf()->seek(position);
+  }
+  inputs_->seekg(position);
+  return inputs_->good();
 }
 
 bool ConfusionProtoIO::ResizeBuffer(int newsize, bool b64) {
@@ -134,15 +230,21 @@ bool ConfusionProtoIO::WriteRaw(const google::protobuf::Message& message) {
     cerr << "No output stream specified" << endl;
     return false;
   }
-  CDEBUG(5, "Writing message of " << message.ByteSize() << " bytes");
-  int num_bytes = message.ByteSize();
-  *outputs_ << num_bytes;
-  ResizeBuffer(num_bytes, false);
-  if (!message.SerializeToArray(iobuffer_, num_bytes)) {
+  using google::protobuf::io::CodedOutputStream;
+  int num_bytes = message.ByteSizeLong();
+  CDEBUG(5, "Writing message of " << num_bytes << " bytes");
+  // Write the varint size and the message into our buffer, so that each
+  // message goes to the stream in a single write.
+  int size_bytes = CodedOutputStream::VarintSize32(num_bytes);
+  ResizeBuffer(size_bytes + num_bytes, false);
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(iobuffer_);
+  CodedOutputStream::WriteVarint32ToArray(num_bytes, buffer);
+  message.SerializeWithCachedSizesToArray(buffer + size_bytes);
+  outputs_->write(iobuffer_, size_bytes + num_bytes);
+  if (!outputs_->good()) {
     cerr << "Unable to write message to stream" << endl;
     return false;
   }
-  outputs_->write(iobuffer_, num_bytes);
   return true;
 }
 
@@ -197,18 +299,49 @@ bool ConfusionProtoIO::WriteBase64(const google::protobuf::Message& message) {
     outputs_->write(b64obuffer_.c_str(), codelength);
     CDEBUG(5, "Wrote message of " << codelength << " base64 encoded bytes");
   }
+  if (!outputs_->good()) {
+    cerr << "Unable to write message to stream" << endl;
+    return false;
+  }
   b64obuffer_.clear();
   return true;
 }
 
+bool ConfusionProtoIO::ReadRawSize(int* num_bytes) {
+  if (framing_ == LEGACY_FRAMING) {
+    *num_bytes = -1;
+    *inputs_ >> *num_bytes;
+    return *num_bytes != -1;
+  }
+  // Read the varint a byte at a time, so that we never consume any of the
+  // stream beyond the message itself.
+  uint8_t varint[kMaxVarint32Bytes];
+  int length = 0;
+  int c;
+  do {
+    c = inputs_->get();
+    if (c == EOF) {
+      return false;
+    }
+    varint[length++] = c;
+  } while ((c & 0x80) != 0 && length < (int)sizeof(varint));
+  google::protobuf::io::CodedInputStream coded_input(varint, length);
+  uint32_t size;
+  if (!coded_input.ReadVarint32(&size)) {
+    cerr << "Unable to read message size" << endl;
+    return false;
+  }
+  *num_bytes = size;
+  return true;
+}
+
 bool ConfusionProtoIO::ReadRaw(google::protobuf::Message* message) {
   if (inputs_ == NULL) {
     cerr << "No input stream specified" << endl;
     return false;
   }
   int num_bytes = -1;
-  *inputs_ >> num_bytes;
-  if (num_bytes == -1) {
+  if (!ReadRawSize(&num_bytes)) {
     CDEBUG(5, "Found end of file");
     return false;
   }
@@ -222,6 +355,23 @@ bool ConfusionProtoIO::ReadRaw(google::protobuf::Message* message) {
   return true;
 }
 
+bool ConfusionProtoIO::Skip() {
+  if (inputs_ == NULL) {
+    cerr << "No input stream specified" << endl;
+    return false;
+  }
+  if (base64_) {
+    getline(*inputs_, b64obuffer_);
+    return !b64obuffer_.empty();
+  }
+  int num_bytes = -1;
+  if (!ReadRawSize(&num_bytes)) {
+    return false;
+  }
+  inputs_->ignore(num_bytes);
+  return inputs_->gcount() == num_bytes;
+}
+
 bool ConfusionProtoIO::DecodeBase64(const string& encodedmsg,
                                     google::protobuf::Message* message) {
   // Assume that the protos were short enough to fit into a single base64 block.
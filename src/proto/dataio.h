@@ -49,7 +49,11 @@ class ConfusionProtoIO {
   enum Mode {
     READ,
     WRITE,
+    // Reads standard input, detecting whether it is compressed.
     READSTD,
+    // Writes standard output, compressing it if requested.  Raw
+    // (non-base64) output starts with a binary header, so it must not be
+    // mixed with line-oriented text such as mapper output.
     WRITESTD
   };
   ConfusionProtoIO();
@@ -57,7 +61,10 @@ class ConfusionProtoIO {
                    bool compressed = true, bool base64 = true);
   ~ConfusionProtoIO();
 
-  void Close();
+  // Closes this object's streams.  Returns false if an output stream
+  // could not be written to or flushed, either when writing messages or
+  // when closing.
+  bool Close();
 
   bool Read(Message* message) {
     if (base64_) {
@@ -73,14 +80,44 @@ class ConfusionProtoIO {
       return WriteRaw(message);
     }
   }
+  // Skips over the next message in the input stream without parsing it.
+  // Returns false at end of file.
+  bool Skip();
   bool DecodeBase64(const string& encodedmsg, Message* message);
   int EncodeBase64(const Message& message, string* encodedmsg);
 
+  // Returns the position in the output stream at which the next message
+  // will be written, or -1 if the stream does not support positioning.
+  // For compressed streams, this is a provisional position that must be
+  // converted with ResolvePosition after the stream has been flushed.
+  long long Tell();
+  // Converts a position returned by Tell into one that can be passed to
+  // Seek when reading the same file.  The output stream must have been
+  // flushed since the position was obtained.
+  long long ResolvePosition(long long position);
+  // Positions the input stream so that the next message read is the one
+  // at the specified position, as returned by ResolvePosition.  Returns
+  // whether the seek succeeded.
+  bool Seek(long long position);
+
   istream* inputstream(void) { return inputs_; }
   ostream* outputstream(void) { return outputs_; }
 
  protected:
+  // Raw (non-base64) files are framed by writing each message's size as
+  // a varint before it, following a magic header that distinguishes them
+  // from legacy files, in which each size was written as decimal text.
+  enum Framing {
+    LEGACY_FRAMING,
+    VARINT_FRAMING
+  };
+  static const char kVarintMagic[];
+  static const int kVarintMagicLength;
+
   bool ResizeBuffer(int num_bytes, bool b64);
+  void DetectFraming();
+  // Reads the size of the next raw message, returning false at end of file.
+  bool ReadRawSize(int* num_bytes);
   bool ReadRaw(Message* message);
   bool WriteRaw(const Message& message);
   bool ReadBase64(Message* message);
@@ -89,6 +126,7 @@ class ConfusionProtoIO {
  private:
   bool base64_;
   bool is_compressed_;
+  Framing framing_;
   istream* inputs_;
   ostream* outputs_;
   char* iobuffer_;